@@ -1,31 +1,61 @@
 #ifndef BUF_H
 #define BUF_H
 
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 #include "db.h"
+#include "replacer.h"
 // define if debug output wanted
 //#define DEBUGBUF
 
 // declarations for buffer pool hash table
-struct hashBucket
+struct hashEntry
 {
-	File*	file;    // pointer a file object (more on this below)
+	const File*	file;    // pointer a file object, NULL if slot is empty
 	int	pageNo;  // page number within a file
 	int	frameNo; // frame number of page in the buffer pool
-	hashBucket* 	next;	 // next node in the hash table
+};
+
+// one independently latched open-addressing table
+struct hashPartition
+{
+	hashEntry*	slots;   // 2^k entries, linear probing
+	unsigned int	mask;    // number of slots - 1
+	int	count;   // number of entries in use
+	mutex	latch;
 };
 
 
-// hash table to keep track of pages in the buffer pool
+// number of independently latched partitions of the buffer hash table
+const int HTPARTITIONS = 16;
+
+// hash table to keep track of pages in the buffer pool.  The table is
+// split into HTPARTITIONS partitions, each with its own latch; a
+// caller must hold partitionLatch(file,pageNo) around insert, lookup
+// and remove of (file,pageNo).
+//
+// Each partition is a flat linear-probing table with backward-shift
+// deletion, sized from the number of buffers so it stays at most half
+// full, so lookup, insert and remove never allocate.  Only if the hash
+// puts far more than its share of pages in one partition is that
+// partition doubled.
 class BufHashTbl
 {
 private:
-    int HTSIZE;
-    hashBucket**  ht; // actual hash table
-    int	 hash(const File* file, const int pageNo); // returns value between 0 and HTSIZE-1
+    hashPartition* parts;
+    unsigned long hash(const File* file, const int pageNo) const;
+    hashPartition & partition(const unsigned long h) const;
+    void grow(hashPartition & part);
 
 public:
-    BufHashTbl(const int htSize);  // constructor
+    BufHashTbl(const int numBufs);  // constructor
     ~BufHashTbl(); // destructor
+
+    // latch protecting the partition (file,pageNo) hashes to
+  mutex & partitionLatch(const File* file, const int pageNo);
 	
     // insert entry into hash table mapping (file,pageNo) to frameNo;
     // returns 0 if OK, HASHTBLERROR if an error occurred
@@ -42,19 +72,37 @@ public:
 };
 
 
+// milliseconds the background writer sleeps between rounds, unless
+// allocBuf wakes it by having to write a victim itself
+const int WRITERINTERVAL = 10;
+
+// most pages BufMgr reads or writes with one readPages/writePages call
+const int IORUN = 32;
+
 class BufMgr;  //forward declaration of BufMgr class 
 
 // class for maintaining information about buffer pool frames
+//
+// Concurrency: file, pageNo and valid change only while a thread owns
+// the frame, i.e. holds its only pin and the frame is not in the hash
+// table.  pinCnt changes under the hash partition latch of the page.
+// latch is held while the frame's contents are read from or written
+// to disk; a thread that pins a page being read in waits on it.
 class BufDesc {
     friend class BufMgr;
+    friend class Replacer;
 private:
-  File* file;   // pointer to file object
-  int   pageNo; // page within file
+  atomic<File*> file;   // pointer to file object
+  atomic<int>   pageNo; // page within file
   int	frameNo;  // frame # of frame
-  int   pinCnt; // number of times this page has been pinned
-  bool 	dirty;	  // true if dirty;  false otherwise
-  bool 	valid;   // true if page is valid
-  bool  refbit;	 // has this buffer frame been reference recently
+  atomic<int>   pinCnt; // number of times this page has been pinned
+  atomic<bool> 	dirty;	  // true if dirty;  false otherwise
+  atomic<bool> 	valid;   // true if page is valid
+  atomic<bool>  refbit;	 // has this buffer frame been reference recently
+  atomic<bool>  prefetched; // read in by read-ahead, not yet requested
+  mutex	latch;	 // held while the frame is being read or written
+  int	fileNext;  // next and previous frame of the same file,
+  int	filePrev;  // -1 at either end; under file->frameLatch
 
   void Clear() {  // initialize buffer frame for a new user
     	pinCnt = 0;
@@ -62,6 +110,7 @@ private:
 	pageNo = -1;
     	dirty = false;
 	valid = false;
+	prefetched = false;
   };
 
   void Set(File* filePtr, int pageNum) { 
@@ -71,23 +120,51 @@ private:
       dirty = false;
       valid = true;
       refbit = true;
+      prefetched = false;
   }
 
   BufDesc() {
       Clear();
+      refbit = false;
+      fileNext = filePrev = -1;
   }
 };
 
 
+// Small private ring of frames for a sequential scan.  Pages the scan
+// faults in are placed in the ring, and once the ring is full the
+// scan's oldest frame is recycled for its next page instead of asking
+// the replacement policy for a victim, so a large scan only ever
+// occupies ring-size frames of the pool.  Read-ahead for the scan
+// takes its frames from the ring as well.
+class BufRing {
+    friend class BufMgr;
+private:
+  int size;             // number of frames in the ring
+  int next;             // slot to recycle next
+  int* frames;          // frame held by each slot, -1 if none
+  PageKey* pages;       // page the ring loaded into each slot
+  mutex latch;          // the scan and the read-ahead thread share the ring
+
+public:
+  BufRing(const int ringSize);
+  ~BufRing();
+};
+
+
 struct BufStats
 {
-  int accesses;    // Total number of accesses to buffer pool
-  int diskreads;   // Number of pages read from disk (including allocs)
-  int diskwrites;  // Number of pages written back to disk
+  atomic<int> accesses;    // Total number of accesses to buffer pool (pins)
+  atomic<int> diskreads;   // Number of pages read from disk (including allocs)
+  atomic<int> diskwrites;  // Number of pages written back to disk
+  atomic<int> prefetches;  // Number of diskreads done by read-ahead
+  atomic<int> victimwrites; // Number of diskwrites of dirty victims
+  atomic<int> bgwrites;    // Number of diskwrites by the background writer
 
   void clear()
     {
-      accesses = diskreads = diskwrites = 0;
+      accesses = diskreads = diskwrites = prefetches = 0;
+      victimwrites = bgwrites = 0;
     }
       
   BufStats()
@@ -97,37 +174,153 @@ struct BufStats
 };
 
 
+// a request to bring up to count pages of file's page chain, starting
+// with pageNo, into the pool ahead of a sequential scan
+struct ReadAheadReq
+{
+  File*	file;
+  int	pageNo;
+  int	count;
+  BufRing*	ring;     // ring of the scan, NULL if it has none
+};
+
+
 class BufMgr 
 {
 private:
-  unsigned int 	 clockHand;
   int   	 numBufs;    	// Number of pages in buffer pool
   BufHashTbl*    hashTable;  	// hash table mapping (File, page) to frame
   BufDesc*	 bufTable;  	// vector of status info, 1 per page
   BufStats	 bufStats;	// buffer pool statistics
+  Replacer*	 replacer;	// replacement policy picking victim frames
+
+  // read-ahead requests are served by a worker thread, started the
+  // first time one is made
+  deque<ReadAheadReq> aheadQueue;
+  const File*	 aheadFile;	// file the worker is reading, NULL if idle
+  atomic<bool>	 aheadCancel;	// abandon the request being served
+  bool		 aheadStop;	// worker should exit
+  mutex		 aheadLatch;	// protects the fields above
+  condition_variable aheadCond;
+  thread	 aheadWorker;
+
+  void readAheadLoop();
+  // bring pageNo and the pages that follow it in the file into the
+  // pool unpinned, reading them with one call, and advance pageNo
+  // along the page chain past those of them that are on it; left is
+  // decremented for each
+  const Status prefetchRun(File* file, int & pageNo, int & left,
+                           BufRing* ring);
+
+  // optional background writer, cleaning the frames the policy will
+  // evict next so that allocBuf does not have to write them
+  atomic<int>	 writerTarget;	// clean frames to keep ready, 0 if no writer
+  bool		 writerStop;	// writer should exit
+  mutex		 writerLatch;	// held by the writer while it works
+  condition_variable writerCond;
+  thread	 writer;
+
+  void writerLoop();
+  void cleanAhead();
+
+  // allocate a frame to hold (file,pageNo), evicting a page if needed.
+  // the frame is returned pinned once and not in the hash table
+  const Status allocBuf(const File* file, const int pageNo, int & frame);
+  // like allocBuf, but reuse the ring's oldest frame when possible
+  const Status allocRingBuf(BufRing* ring, const File* file,
+                            const int pageNo, int & frame);
+
+  // write back frame, which should hold (file,pageNo), if it is dirty.
+  // with evict, also take it out of the hash table.  returns PAGEPINNED
+  // if the page is pinned, or (evict only) gets pinned or dirtied while
+  // it is written
+  const Status writeFrame(const int frame, const File* file,
+                          const int pageNo, const bool evict);
+  // writeFrame for each of pages, sorted by file and page number;
+  // dirty neighbouring pages go to disk in one call.  status[i] is
+  // what writeFrame would have returned for pages[i]
+  void writeFrames(const vector<hashEntry> & pages, const bool evict,
+                   vector<Status> & status);
+
+  // the steps of writeFrame: pin frame if it holds (file,pageNo) and
+  // is unpinned; write out the dirty ones of n claimed frames holding
+  // consecutive pages of one file; drop the pin, evicting the page
+  // if asked to and nobody pinned or dirtied it meanwhile
+  const Status claimFrame(const int frame, const File* file,
+                          const int pageNo);
+  const Status writeClaimed(const hashEntry* run, const int n);
+  const Status releaseFrame(const int frame, const File* file,
+                            const int pageNo, const bool evict);
 
-  const Status allocBuf(int & frame);   // allocate a free frame.  
+  // make (file,pageNo) in an owned frame visible in the hash table,
+  // or pin the copy another thread brought in first
+  const Status installFrame(File* file, const int pageNo, int & frame,
+                            bool & installed);
+
+  // read (file,pageNo), which was not found in the hash table, into a
+  // new frame and pin it.  loaded is false if another thread installed
+  // the page first; frame is then its frame, pinned but possibly still
+  // being read
+  const Status fetchPage(File* file, const int pageNo, BufRing* ring,
+                         int & frame, bool & loaded);
+  // the steps of fetchPage around the read: a pinned frame installed
+  // and latched for (file,pageNo), unless loaded comes back false;
+  // then, given the status of the read, either make the page available
+  // or withdraw the frame
+  const Status reserveFrame(File* file, const int pageNo, BufRing* ring,
+                            int & frame, bool & loaded);
+  const Status completeRead(File* file, const int pageNo, const int frame,
+                            const Status status, const bool prefetch);
+
+  // add frame to, or take it off, the frame list of the file it holds
+  void linkFrame(const int frame);
+  void unlinkFrame(const int frame);
+  // empty an owned frame: off its file's list, then Clear()
+  void clearFrame(const int frame);
+
+  // wait until a concurrent read of the pinned frame completes;
+  // returns false if that read failed
+  bool waitForFrame(const int frame, const File* file, const int pageNo);
   const void releaseBuf(int frame); // return unused frame to end of list
-  void advanceClock()
-  {
-	clockHand = (clockHand + 1) % numBufs;
-  }
 
 
 public:
   Page*	         bufPool;   // actual buffer pool
 
-  BufMgr(const int bufs);
+  BufMgr(const int bufs, const ReplPolicy policy = CLOCK);
   ~BufMgr();
 
-  const Status readPage(File* file, const int PageNo, Page*& page);
+  // if ring is given, a page that is not resident is read into one
+  // of the ring's frames rather than a frame picked by the policy
+  const Status readPage(File* file, const int PageNo, Page*& page,
+                        BufRing* ring = NULL);
   const Status unPinPage(File* file, const int PageNo, const bool dirty);
   const Status allocPage(File* file, int& PageNo, Page*& page); 
                         // allocates a new, empty page 
-  const Status flushFile(const File* file); // writing out all dirty pages of the file
+  // write out all dirty pages of the file, in page order, and drop
+  // its pages from the pool; takes time in the file's resident pages
+  const Status flushFile(const File* file);
   const Status disposePage(File* file, const int PageNo); // dispose of page in file
+  // drop the page from the pool without writing it, as when the
+  // file was written behind the pool's back; PAGEPINNED if pinned
+  const Status discardPage(const File* file, const int pageNo);
+
+  // start bringing up to count pages of file's page chain, beginning
+  // with pageNo, into the pool in the background.  With a ring, the
+  // pages go into the ring's frames and count is capped at half the
+  // ring.  A request replaces any queued one for the same file and ring
+  void readAhead(File* file, const int pageNo, const int count,
+                 BufRing* ring = NULL);
+  // drop queued read-ahead for file and wait for any in progress
+  void cancelReadAhead(const File* file);
+
+  // run a background writer keeping the next cleanFrames frames the
+  // replacement policy would evict clean; 0 stops it
+  void setWriter(const int cleanFrames);
   void  printSelf();
 
+  int getNumBufs() const { return numBufs; }
+
   const BufStats & getBufStats() const // get buffer pool usage
   {
 	return bufStats;
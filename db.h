@@ -3,6 +3,8 @@
 
 #include <sys/types.h>
 #include <functional>
+#include <atomic>
+#include <mutex>
 #include "error.h"
 #include <string.h>
 using namespace std;
@@ -12,6 +14,9 @@ using namespace std;
 //#define DEBUGIO
 //#define DEBUGFREE
 
+// pages a file grows by at a time unless createFile is told otherwise
+const int EXTENTSIZE = 64;
+
 // forward class definition for db
 class DB;
 
@@ -19,15 +24,31 @@ class DB;
 class File {
   friend class DB;
   friend class OpenFileHashTbl;
+  friend class BufMgr;
 
  public:
 
-  Status allocatePage(int& pageNo);     // allocate a new page
+  // allocate a new page; unless reuse is set the file is extended,
+  // so successive calls hand out consecutive pages
+  Status allocatePage(int& pageNo, const bool reuse = true);
   const Status disposePage(const int pageNo);       // release space for a page
   const Status readPage(const int pageNo,
 		  Page* pagePtr) const;       // read page from file
   const Status writePage(const int pageNo,
 		   const Page* pagePtr);      // write page to file
+
+  // read count consecutive pages starting at pageNo into pages[] with
+  // one system call; a run reaching past the end of the file stops
+  // short, numRead is the number of whole pages read
+  const Status readPages(const int pageNo, Page* const pages[],
+                         const int count, int& numRead) const;
+  // write count consecutive pages starting at pageNo from pages[]
+  const Status writePages(const int pageNo, const Page* const pages[],
+                          const int count);
+  const Status getPageCnt(int& pageCnt) const;      // pages in the file
+
+  // write the cached DB header page back to the file if it changed
+  const Status sync();
   const Status getFirstPage(int& pageNo) const;     // returns pageNo of first page
 
   bool operator == (const File & other) const
@@ -40,7 +61,7 @@ class File {
   File(const string &fname);                   // initialize
   ~File();                  // deallocate file object
 
-  static const Status create(const string &fileName);
+  static const Status create(const string &fileName, const int extentPages);
   static const Status destroy(const string &fileName);
 
   const Status open();
@@ -50,6 +71,8 @@ class File {
 		 Page* pagePtr) const;        // internal file read
   const Status intwrite(const int pageNo,
 		  const Page* pagePtr);       // internal file write
+  const Status writeHeader();          // write back the cached header
+  const Status reserveExtent();        // grow the Unix file by an extent
 
 #ifdef DEBUGFREE
   void listFree();                      // list free pages
@@ -58,6 +81,26 @@ class File {
   string fileName;                    // The name of the file
   int openCnt;                        // # times file has been opened
   int unixFile;                       // unix file stream for file
+
+  // the DB header page (page 0), read on the first open and kept
+  // here until sync() or the last close writes it back.  Pages past
+  // the end of the Unix file but below numPages have been allocated
+  // and not written yet; they read as zeros.  The Unix file grows
+  // extentSize pages at a time, so pages from numPages up to
+  // reservedPages already have disk space and lie contiguous with
+  // the pages before them.
+  int nextFree;                       // page # of next page on free list
+  int firstPage;                      // page # of first page in file
+  atomic<int> numPages;               // total # of pages in file
+  int extentSize;                     // pages reserved per extension
+  int reservedPages;                  // end of the last extent reserved
+  bool hdrDirty;                      // header changed since last written
+  mutable mutex hdrLatch;             // protects the header fields
+
+  // frames of this file in the buffer pool, a list BufMgr threads
+  // through its frame descriptors
+  int firstFrame;                     // -1 if none
+  mutable mutex frameLatch;           // protects the list
 };
 
 class BufMgr;
@@ -103,7 +146,9 @@ class DB {
   DB();                                 // initialize open file table
   ~DB();                                // clean up any remaining open files
 
-  const Status createFile(const string & fileName) ;  // create a new file
+  // create a new file that grows extentPages pages at a time
+  const Status createFile(const string & fileName,
+                          const int extentPages = EXTENTSIZE);
   const Status destroyFile(const string & fileName) ; // destroy a file, 
                                                            // release all space
   const Status openFile(const string & fileName, File* & file);  // open a file
@@ -120,6 +165,9 @@ typedef struct {
   int nextFree;                         // page # of next page on free list
   int firstPage;                        // page # of first page in file
   int numPages;                         // total # of pages in file
+  int extentSize;                       // pages reserved per extension
+  int reservedPages;                    // pages reserved on disk; the
+                                        // boundary of the last extent
 } DBPage;
 
 #endif
@@ -19,9 +19,162 @@ extern DB db;
 // Some constant definitions
 const unsigned MAXNAMESIZE = 50;
 
+// largest buffer ring a sequential scan uses; scans of files bigger
+// than a quarter of the buffer pool get one by default
+const int SCANRINGSIZE = 16;
+
+// pages of the page chain a sequential scan asks the buffer manager
+// to read ahead of it by default
+const int READAHEAD = 8;
+
 enum Datatype { STRING, INTEGER, FLOAT };    // attribute data types
 enum Operator { LT, LTE, EQ, GTE, GT, NE };  // scan operators
 
+// A zone map keeps the least and greatest value of an INTEGER or FLOAT
+// attribute on each data page, so that a scan with a predicate on the
+// attribute can pass over pages that cannot hold a match without
+// reading them.  The header lists up to ZONEMAPS attributes; each
+// directory page has a zone page per attribute whose entry i is the
+// zone of the data page in the directory page's entry i.  A page with
+// stubs on it, or one an InsertFileScan is adding to, has a zone
+// covering every value.
+const int ZONEMAPS = 4;
+
+struct ZoneAttr
+{
+  int		offset;		// of the attribute in the record
+  Datatype	type;		// INTEGER or FLOAT
+};
+
+// lo > hi if the page has no value of the attribute
+struct ZoneEntry
+{
+  union { int i; float f; } lo, hi;
+};
+
+// The header also lists up to MAXINDEXES hash indexes on attributes of
+// the records (see index.h), which the heap file keeps up to date as
+// records come, go and change.
+const int MAXINDEXES = 4;
+
+struct IndexAttr
+{
+  int		offset;		// of the key in the record
+  int		length;		// of the key
+  Datatype	type;
+};
+
+// The free-space map records, for every data page, how much room it
+// has left in units of FSMUNIT bytes, one byte per page.  Each FSM page
+// holds a binary max-tree over FSMLEAVES pages, so the page numbers
+// pageNo / FSMLEAVES == k are covered by the k-th FSM page; node 1 is
+// the root and the leaves are nodes FSMLEAVES .. 2*FSMLEAVES-1.  The
+// header page lists the FSM pages together with the root of each, so
+// finding a page with room takes a look at the header and one
+// descent of a tree.  Pages past the last FSM page the header has
+// room for are not tracked and never reused.
+const int FSMLEAVES = PAGESIZE / 2;
+const int FSMUNIT = (PAGESIZE + 255) / 256;
+
+// The page directory lists the data pages in page chain order, with
+// the free space and record count of each as of the last time they
+// were recorded in the free-space map.  Entry n is entry n % DIRENTRIES
+// of the directory page the header lists at dirPage[n / DIRENTRIES],
+// and every data page knows its entry (Page::getDirSlot), so both the
+// n-th page of the file and the entry of a given page are found
+// without following the chain.  Pages past what the header has room
+// for are not listed; the chain still reaches them.
+struct DirEntry
+{
+  int		pageNo;		// data page
+  short		freeSpace;	// bytes free on it
+  short		recCnt;		// records on it
+};
+
+const int DIRENTRIES = (PAGESIZE - ZONEMAPS * sizeof(int)) / sizeof(DirEntry);
+
+// directory pages per FSM page, so that the two cover as many pages
+// and share the header between them
+const int DIRPERFSM = FSMLEAVES / DIRENTRIES;
+const int FSMDIR = (PAGESIZE - MAXNAMESIZE - 9 * sizeof(int)
+                   - ZONEMAPS * sizeof(ZoneAttr)
+                   - MAXINDEXES * sizeof(IndexAttr))
+                   / (sizeof(int) + 1 + DIRPERFSM * sizeof(int)) - 1;
+const int DIRDIR = FSMDIR * DIRPERFSM;
+
+struct FSMPage
+{
+  unsigned char node[2 * FSMLEAVES];   // node[0] is unused
+};
+
+struct DirPage
+{
+  DirEntry	entry[DIRENTRIES];
+  int		zonePage[ZONEMAPS];	// pageNo of each zone page, -1 if none
+};
+
+struct ZonePage
+{
+  ZoneEntry	entry[DIRENTRIES];
+};
+
+// A record too long for a data page is an overflow record: its bytes
+// go in a chain of overflow pages of its own and its slot holds only
+// an OverflowStub (see page.h for stubs).  Overflow pages are on
+// neither the page chain nor the directory nor the free-space map;
+// they are freed with the record.
+struct OverflowStub
+{
+  int		type;		// OVERFLOWSTUB
+  int		length;		// of the whole record
+  int		firstPage;	// first overflow page
+};
+
+// A record updated to more than its page has room for moves to another
+// page, as a MOVEDREC stub: a MovedHdr followed by the record.  Its
+// slot keeps a ForwardStub, so its RID stays the same, and the MovedHdr
+// names the slot, so the copy can be moved on to make room where it is.
+struct ForwardStub
+{
+  int		type;		// FORWARDSTUB
+  int		length;		// of the record
+  RID		rid;		// of the moved record
+};
+
+struct MovedHdr
+{
+  int		type;		// MOVEDREC
+  RID		home;		// of the record, holding its ForwardStub
+};
+
+const int MOVEDHDR = sizeof(MovedHdr);
+
+// a stub copied off its page
+union Stub
+{
+  int		type;
+  OverflowStub	overflow;
+  ForwardStub	forward;
+};
+
+const int OVERFLOWDATA = PAGESIZE - sizeof(int);
+
+struct OverflowPage
+{
+  int		nextPage;	// next page of the record, -1 at the last
+  char		data[OVERFLOWDATA];
+};
+
+// most pages a batch of HeapFileScan::scanNextBatch keeps pinned
+const int BATCHPAGES = 8;
+// records scanNextBatch looks at at a time when not returning them
+const int BATCHCHUNK = 64;
+// records a scan predicate's pass rate is taken over
+const int PREDWINDOW = 4096;
+
+// pages a HeapFileBulkLoader fills in memory before writing them out
+const int BULKPAGES = 64;
+
 struct FileHdrPage
 {
   char		fileName[MAXNAMESIZE];   // name of file
@@ -29,8 +182,22 @@ struct FileHdrPage
   int		lastPage;	// pageNo of last data page in file
   int		pageCnt;	// number of pages
   int		recCnt;		// record count
+  int		fsmCnt;		// number of FSM pages
+  int		fsmPage[FSMDIR];	// pageNo of each FSM page
+  unsigned char	fsmMax[FSMDIR];	// root of each FSM page's tree
+  int		dirCnt;		// number of data pages in the directory
+  int		dirPageCnt;	// number of directory pages
+  int		dirPage[DIRDIR];	// pageNo of each directory page
+  int		zoneCnt;	// number of zone maps
+  ZoneAttr	zone[ZONEMAPS];	// attribute of each
+  int		indexCnt;	// number of indexes
+  IndexAttr	index[MAXINDEXES];	// attribute of each
 };
 
+static_assert(sizeof(FileHdrPage) <= PAGESIZE, "the header must fit a page");
+
+
+class Index;
 
 // class definition of heapFile
 class HeapFile {
@@ -45,6 +212,57 @@ protected:
    bool  	curDirtyFlag;   // true if page has been updated
    RID   	curRec;         // rid of last record returned
 
+   vector<Index*> indexes;	// those of headerPage->index opened so far
+
+   // record in the free-space map that pageNo has freeBytes free
+   const Status setFreeSpace(const int pageNo, const int freeBytes);
+   // find a data page with at least needBytes free; -1 if there is none
+   const Status findFreePage(const int needBytes, int & pageNo);
+   // record page, which is pageNo, as entry n of the page directory
+   // and give it that slot, unless n is past what the directory covers
+   const Status setDirEntry(const int n, const int pageNo, Page* page);
+   // record the free space and record count of data page pageNo in the
+   // free-space map and the page directory
+   const Status notePage(const int pageNo, Page* page);
+   // set the zone map entries of page, entry n of the page directory:
+   // to the least and greatest values on it, or with open to cover
+   // every value
+   const Status setZones(const int n, const Page* page, const bool open);
+   // allocate a data page and link it after the last one, leaving
+   // it pinned
+   const Status appendPage(int & pageNo, Page* & page);
+   // copy rec to a chain of new overflow pages and fill in its stub
+   const Status writeOverflow(const Record & rec, OverflowStub & stub);
+   // free the overflow pages of the record stub stands for
+   const Status freeOverflow(const OverflowStub & stub);
+   // put rec on a data page other than curPage
+   const Status placeRecord(const Record & rec, RID & outRid);
+   // free what stub points to: overflow pages or a moved record
+   const Status freeStub(const Stub & stub);
+   // copy the stub rec, of a record kept elsewhere, off its page;
+   // BADRECPTR if it is not one
+   static const Status readStub(const Record & rec, Stub & stub);
+   // open the indexes of the file not open yet
+   const Status openIndexes();
+   // the key of rec for each of the file's indexes, one after another
+   // in keys; has[i] is false if rec is too short for index i's key
+   const Status indexKeys(const Record & rec, vector<char> & keys,
+                          vector<bool> & has);
+   // change rid's index entries from the keys oldKeys to newKeys, as
+   // indexKeys gave them; an empty has stands for no record
+   const Status updateIndexes(const RID & rid,
+                              const vector<char> & oldKeys,
+                              const vector<bool> & oldHas,
+                              const vector<char> & newKeys,
+                              const vector<bool> & newHas);
+   // updateRecord, less the indexes
+   const Status replaceRecord(const RID & rid, const Record & rec);
+   // make rec, the record of slot home, a MOVEDREC stub in buf
+   static void movedCopy(const Record & rec, const RID & home, char* buf,
+                         Record & moved);
+   // move one record other than keep off curPage, to make room on it
+   const Status makeRoom(const RID & keep);
+
 public:
 
   // initialize
@@ -56,8 +274,65 @@ public:
   // return number of records in file
   const int getRecCnt() const;
 
-  // given a RID, read record from file, returning pointer and length
+  // return number of pages in file
+  const int getPageCnt() const;
+
+  // return number of data pages in the page directory
+  const int getDirCnt() const;
+
+  // the directory entry of the n-th data page, n < getDirCnt()
+  const Status getDirEntry(const int n, DirEntry & entry);
+
+  // page numbers of all data pages in chain order: the directory's,
+  // then any past its end found by following the chain
+  const Status listPages(vector<int> & pageNos);
+
+  // keep a zone map of the INTEGER or FLOAT attribute at offset for
+  // scans to skip pages by; FILEHDRFULL if there are ZONEMAPS already
+  const Status addZoneMap(const int offset, const Datatype type);
+
+  // index the records by the length bytes at offset, read as type; a
+  // record too short to have them is left out.  INDEXEXISTS if there
+  // is an index on offset already, FILEHDRFULL if there are MAXINDEXES.
+  // IndexScan looks records up by it
+  const Status addIndex(const int offset, const int length,
+                        const Datatype type);
+
+  // given a RID, read record from file, returning pointer and length;
+  // for a record kept elsewhere (overflow or moved), its stub
   const Status getRecord(const RID &rid, Record & rec);
+
+  // replace the record with RID rid by rec.  The RID stays the same:
+  // if rec does not fit on the record's page it goes to another and
+  // the page keeps a stub pointing to it
+  const Status updateRecord(const RID & rid, const Record & rec);
+
+  // one piece of a record, for readRecord; false stops the reading
+  typedef function<bool(const char* data, const int length)> PieceFn;
+
+  // length of rec, a record or stub from getRecord or a scan
+  static const int recLength(const Record & rec);
+
+  // call fn on each piece of rec in turn: for an inline record the
+  // record itself, for an overflow record the part of it on each of
+  // its pages, which stays pinned only until fn returns
+  const Status readRecord(const Record & rec, const PieceFn & fn);
+
+  // copy the length bytes of rec starting at offset to buf
+  const Status readRecord(const Record & rec, const int offset,
+                          const int length, void* buf);
+};
+
+
+// one condition of a filtered scan: the length bytes at offset in a
+// record, read as type, compared with the value at filter by op
+struct ScanPred
+{
+    int   offset;
+    int   length;
+    Datatype type;
+    const char* filter;
+    Operator op;
 };
 
 
@@ -76,6 +351,13 @@ public:
                            const char* filter, 
                            const Operator op);
 
+    // scan for the records matching all count predicates, or with any
+    // set, those matching at least one.  The scan tries them in order
+    // of how often they have passed so far, so that most records are
+    // settled by the first one or two
+    const Status startScan(const ScanPred preds[], const int count,
+                           const bool any = false);
+
     const Status endScan(); // terminate the scan
     const Status markScan(); // save current position of scan
     const Status resetScan(); // reset scan to last marked location
@@ -83,21 +365,82 @@ public:
     // return RID of next record that satisfies the scan 
     const Status scanNext(RID& outRid);
 
-    // read current record, returning pointer and length
+    // return up to max of the next records that satisfy the scan,
+    // their RIDs in outRids and, unless recs is NULL, the records in
+    // recs.  The pages the records are on stay pinned until the next
+    // call on the scan.  OK as long as count > 0, FILEEOF after that
+    const Status scanNextBatch(RID outRids[], Record recs[],
+                               const int max, int & count);
+
+    // read current record, returning pointer and length; for an
+    // overflow record, its stub
     const Status getRecord(Record & rec);
 
-    // delete current record 
+    // replace current record by rec, as HeapFile::updateRecord
+    const Status updateRecord(const Record & rec);
+
+    // delete current record, with whatever its stub points to
     const Status deleteRecord();
 
     // marks current page of scan dirty
     const Status markDirty();
 
+    // read pages through a private ring of the given number of
+    // frames; 0 lets the scan fault pages into the shared pool
+    const Status setRing(const int frames);
+
+    // number of pages to read ahead of the scan; 0 turns read-ahead off
+    const Status setReadAhead(const int pages);
+
+    // evaluate INTEGER and FLOAT filters a page at a time with the
+    // vector kernels of vecfilter.h (the default) rather than a record
+    // at a time; takes effect at the next startScan
+    const Status setPageFilter(const bool on);
+
+    // go to the start of page pageNo and stay on it: scanNext and
+    // scanNextBatch return FILEEOF at its end rather than following
+    // the page chain, until the next startPage.  The predicates of
+    // startScan stay in force
+    const Status startPage(const int pageNo);
+
+    // drop from pageNos, listed as by listPages, the pages the zone
+    // maps show cannot hold a record matching the scan
+    const Status prunePages(vector<int> & pageNos);
+
 private:
-    int   offset;            // byte offset of filter attribute
-    int   length;            // length of filter attribute
-    Datatype type;           // datatype of filter attribute
-    const char* filter;      // comparison value of filter
-    Operator op;             // comparison operator of filter
+    struct Pred;
+
+    // a predicate compiled by startScan: a function per (type, op)
+    // pair, one testing a record and one compacting a batch of them
+    typedef bool (*MatchFn)(const Pred & pred, const Record & rec);
+    typedef int (*FilterFn)(const Pred & pred, RID rids[],
+                            Record recs[], const int count);
+
+    struct Pred : ScanPred
+    {
+        int   intFilter;         // filter decoded, for INTEGER
+        float floatFilter;       // and FLOAT attributes
+        MatchFn match;
+        FilterFn filterBatch;
+        HeapFile* file;          // to read overflow records through
+        double tested;           // records tried, recently
+        double passed;           // and how many of them matched
+    };
+
+    // The predicates evaluated a page at a time come first, the rest
+    // are tried on each record after those.
+    vector<Pred> preds;
+    int   pagePreds;         // number of page-evaluated preds
+    bool  anyPred;           // records need match only one of preds
+
+    // With a page filter, scanNext and scanNextBatch evaluate the
+    // filter on all of a page's records when they get to the page and
+    // then walk the slots whose bits are set.  Records added to the
+    // page after that are not seen.
+    bool  pageFilter;        // setPageFilter
+    bool  vectorScan;        // pagePreds > 0; scanNext uses matchBits
+    int   matchPageNo;       // page matchBits was computed for, -1 if none
+    unsigned long long matchBits[(MAXSLOTS + 63) / 64];  // by slot number
 
      // The following variables are used to preserve the state
     // of the scan when the method markScan() is invoked.
@@ -106,7 +449,102 @@ private:
     int   markedPageNo;	// page number of pinned page
     RID   markedRec;         // rid of last record returned
 
-    const bool matchRec(const Record & rec) const;
+    BufRing* ring;          // frames this scan recycles, NULL if none
+
+    bool  onePage;           // startPage was called
+
+    int   aheadPages;        // read-ahead window, 0 if none
+    int   aheadLeft;         // pages left of the last read-ahead request
+
+    // a pred on an attribute with a zone map
+    struct ZoneCheck
+    {
+        int   zone;              // in headerPage->zone
+        Operator op;
+        int   intKey;
+        float floatKey;
+    };
+    // empty unless they can rule pages out: with anyPred, only if
+    // every pred has one
+    vector<ZoneCheck> zoneChecks;
+    int   zoneRunEnd;        // directory entries before it not ruled out
+
+    // pages before curPage that the last batch returned records
+    // from, with their dirty flags
+    vector<pair<int, bool> > batchPages;
+
+    // the record-at-a-time preds' verdict on rec
+    const bool matchRec(const Record & rec)
+    {
+        int i = pagePreds, n = preds.size();
+        for (; i < n; i++)
+        {
+            Pred & p = preds[i];
+            bool m = p.match(p, rec);
+            p.tested++;
+            if (m) p.passed++;
+            if (m == anyPred) return m;
+        }
+        return !anyPred || pagePreds == n;
+    }
+
+    // drop the records of a batch that fail the record-at-a-time preds
+    int filterRecs(RID rids[], Record recs[], int count);
+    void orderPreds();       // by pass rate, best at rejecting first
+
+    template <Datatype T, Operator O>
+    static bool matchAttr(const Pred & pred, const Record & rec);
+    template <Datatype T, Operator O>
+    static int filterAttr(const Pred & pred, RID rids[],
+                          Record recs[], const int count);
+    template <Datatype T>
+    static void bindFilter(Pred & pred);
+    void evalPage();                        // fill matchBits for curPage
+    // the next records after curRec whose bits in matchBits are set
+    const Status nextMatches(RID rids[], Record recs[], const int max,
+                             int & count);
+    void readAhead();        // keep the pages after curPage coming in
+    // the page to scan after curPage and the number of pages from it
+    // on, up to run, that the zone maps do not rule out
+    const Status nextPage(int & pageNo, int & run);
+    // move n to the first directory entry from n on, before end, whose
+    // page the zone maps do not rule out, or to end; pageNo is its page
+    // and run the number of entries from it, up to run, not ruled out
+    const Status zoneNext(int & n, const int end, int & run, int & pageNo);
+    const Status releaseBatch(); // unpin batchPages
+};
+
+
+// Scans a heap file with several threads.  The data pages are listed
+// first; then each worker takes the next page nobody has scanned yet,
+// filters it through its own HeapFileScan and hands what matches to
+// the callback.  The callback runs on the worker threads, concurrently
+// and in no particular page order, and the records it gets are only
+// valid until it returns.  Overflow records come as their stubs, which
+// the callback can read with this object's readRecord.
+class ParallelHeapScan : public HeapFile
+{
+public:
+
+    typedef function<void(const RID & rid, const Record & rec)> RecordFn;
+    // the matching records of one page
+    typedef function<void(const RID rids[], const Record recs[],
+                          const int count)> BatchFn;
+
+    // threads workers, 0 for one per core
+    ParallelHeapScan(const string & name, Status & status,
+                     const int threads = 0);
+
+    // call fn for each record matching preds, as with
+    // HeapFileScan::startScan; returns once every page is done
+    const Status scan(const ScanPred preds[], const int count,
+                      const bool any, const RecordFn & fn);
+    const Status scanBatches(const ScanPred preds[], const int count,
+                             const bool any, const BatchFn & fn);
+
+private:
+    string fileName;
+    int   workers;
 };
 
 
@@ -119,8 +557,51 @@ public:
     // end filtered scan
     ~InsertFileScan();
 
-    // insert record into file, returning its RID
+    // insert record into file, returning its RID; one too long for a
+    // page is written to overflow pages
     const Status insertRecord(const Record & rec, RID& outRid); 
+
+private:
+    int   zonesOpen;         // zone maps opened for inserts on curPage
+
+    const Status insertInline(const Record & rec, RID& outRid);
+};
+
+
+// Appends records to a heap file a page at a time: pages are packed in
+// private memory and written BULKPAGES at a time straight to the file,
+// bypassing the buffer pool.  The new pages are linked into the file
+// and the header updated only by finish() (or the destructor), so the
+// records are not visible to scans until then.
+class HeapFileBulkLoader : public HeapFile
+{
+public:
+
+    HeapFileBulkLoader(const string & name, Status & status);
+
+    // finishes the load
+    ~HeapFileBulkLoader();
+
+    // add a record, returning the RID it will have
+    const Status addRecord(const Record & rec, RID& outRid);
+
+    // add count records
+    const Status addRecords(const Record recs[], const int count);
+
+    // write out the remaining pages and link them into the file
+    const Status finish();
+
+private:
+    vector<Page> pages;      // pages being filled, the last one open
+    vector<int> pageNos;     // page number of each
+    int   used;              // pages in use
+    int   firstNew;          // first page loaded, -1 if none yet
+    int   lastNew;           // last page loaded
+    int   newPages;          // pages loaded
+    int   newRecs;           // records loaded
+
+    const Status newPage();
+    const Status writePages(const int count);
 };
 
 #endif
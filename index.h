@@ -0,0 +1,146 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "heapfile.h"
+
+// A hash index maps the key of each record of a heap file, the length
+// bytes at offset read as type and compared as a scan compares them,
+// to the RIDs of the records with that key.  It has a file of its own,
+// named by indexName, and the heap file keeps it up to date (see
+// HeapFile::addIndex).
+//
+// It uses linear hashing.  The file starts with INITBUCKETS buckets;
+// whenever the entries fill more than SPLITFILL percent of a page per
+// bucket, bucket next is split into itself and bucket next + n, where
+// n = INITBUCKETS << level, and next moves on.  Once every one of the n
+// buckets is split, level goes up and next starts over, so the number
+// of buckets grows one at a time and a key's bucket is its hash modulo
+// n, or 2n if that is below next.  A bucket is a chain of pages, most
+// of the time one.
+
+// buckets of a new index
+const int INITBUCKETS = 4;
+// percent of a page per bucket the entries may fill before a split
+const int SPLITFILL = 80;
+
+// A bucket page holds count entries, each the key followed by the RID.
+const int BUCKETDATA = PAGESIZE - 2 * sizeof(int);
+
+struct BucketPage
+{
+  int		nextPage;	// next page of the bucket, -1 at the last
+  int		count;		// entries on this page
+  char		data[BUCKETDATA];
+};
+
+// The first page of each bucket is entry b % BUCKETDIR of the
+// directory page the header lists at dirPage[b / BUCKETDIR].
+const int BUCKETDIR = PAGESIZE / sizeof(int);
+
+struct BucketDirPage
+{
+  int		bucketPage[BUCKETDIR];
+};
+
+const int IDXDIR = (PAGESIZE - 9 * sizeof(int)) / sizeof(int);
+
+struct IndexHdrPage
+{
+  int		offset;		// of the key in a record
+  int		length;		// of the key
+  Datatype	type;		// of the key
+  int		level;		// buckets INITBUCKETS << level are unsplit
+  int		next;		// next bucket to split
+  int		bucketCnt;	// number of buckets
+  int		entryCnt;	// number of entries
+  int		dirPageCnt;	// number of directory pages
+  int		dirPage[IDXDIR];	// pageNo of each directory page
+};
+
+static_assert(sizeof(IndexHdrPage) <= PAGESIZE, "the header must fit a page");
+
+// name of the index on offset of heap file fileName
+const string indexName(const string & fileName, const int offset);
+
+// create an empty index file for keys of length bytes at offset; no
+// more than BUCKETDATA / 4 bytes of key and RID, so a page holds four
+const Status createIndex(const string & name, const int offset,
+                         const int length, const Datatype type);
+
+const Status destroyIndex(const string & name);
+
+
+class Index
+{
+protected:
+   File*	filePtr;	// underlying DB File object
+   IndexHdrPage* headerPage;	// pinned header page in buffer pool
+   int		headerPageNo;	// page number of header page
+   bool		hdrDirtyFlag;	// true if header page has been updated
+   int		entrySize;	// bytes of an entry, key and RID
+   int		perPage;	// entries on a bucket page
+
+   const unsigned int hash(const void* key) const;
+   const bool sameKey(const void* a, const void* b) const;
+   // bucket a key with hash h goes in
+   const int bucketOf(const unsigned int h) const;
+   // first page of bucket b
+   const Status getBucket(const int b, int & pageNo);
+   const Status setBucket(const int b, const int pageNo);
+   // add entry, key and RID, to a page of bucket b with room
+   const Status putEntry(const int b, const char* entry);
+   // split bucket next
+   const Status split();
+
+public:
+
+  // open the index file name
+  Index(const string & name, Status & status);
+
+  ~Index();
+
+  const int getOffset() const;
+  const int getLength() const;
+  const Datatype getType() const;
+
+  // number of entries, and of buckets
+  const int getEntryCnt() const;
+  const int getBucketCnt() const;
+
+  // add an entry for key and rid, on the first page of its bucket
+  // with room; a key may have any number of entries
+  const Status insertEntry(const void* key, const RID & rid);
+
+  // remove the entry for key and rid; RECNOTFOUND if there is none
+  const Status deleteEntry(const void* key, const RID & rid);
+
+  // append the RIDs of the entries with key to rids
+  const Status lookup(const void* key, vector<RID> & rids);
+};
+
+
+// Looks up the records of a heap file with a given key through its
+// index on the key's offset, returning their RIDs in no particular
+// order for HeapFile::getRecord to read.  The RIDs of a key are taken
+// from the index all at once, by startScan.
+class IndexScan : public Index
+{
+public:
+
+    // scan the index of heap file fileName on the attribute at offset
+    IndexScan(const string & fileName, const int offset, Status & status);
+
+    // find the records whose key equals key, which is getLength() bytes
+    const Status startScan(const void* key);
+
+    // RID of the next of them; NOMORERECS when there are no more
+    const Status scanNext(RID & outRid);
+
+    const Status endScan();
+
+private:
+    vector<RID> rids;
+    unsigned int next;       // in rids
+};
+
+#endif
@@ -11,27 +11,52 @@ struct RID{
 
 const RID NULLRID = {-1,-1};
 
+// A record of negative length is a stub of -length bytes, which the
+// heap file uses for records kept elsewhere.  A stub starts with an int
+// giving its StubType.  MOVEDREC stubs hold a record moved there from
+// another page; they are reached only through that page, so the page
+// leaves them out of firstRecord, nextRecord, nextRecords, gatherAttr
+// and getRecCnt.
+enum StubType { OVERFLOWSTUB = 1, FORWARDSTUB, MOVEDREC };
+
 struct Record
 {
   void* data;
   int length;
 };
 
+// Bytes of data[] a record or stub of the given length takes up.
+inline int recSpace(const int length)
+{
+    return length < 0 ? -length : length;
+}
+
 // slot structure
 struct slot_t {
         short	offset;  
-        short	length;  // equals -1 if slot is not in use
+        short	length;  // equals -1 if slot is not in use, less than
+                         // that for a stub of -length bytes
 };
 
-const unsigned PAGESIZE = 1024;
-const unsigned DPFIXED= sizeof(slot_t)+4*sizeof(short)+2*sizeof(int);
+// The page size is chosen when building (make PAGESIZE=8192).  Offsets
+// within a page are shorts, which is fine up to 32 KB.
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 1024
+#endif
+const unsigned PAGESIZE = PAGE_SIZE;
+static_assert(PAGESIZE >= 1024 && PAGESIZE <= 32768 &&
+              (PAGESIZE & (PAGESIZE - 1)) == 0,
+              "PAGESIZE must be a power of two from 1 KB to 32 KB");
+const unsigned DPFIXED= sizeof(slot_t)+4*sizeof(short)+3*sizeof(int);
 const unsigned PAGEDATASIZE = PAGESIZE-DPFIXED+sizeof(slot_t);
 // size of the data area of a page
+const int MAXSLOTS = PAGEDATASIZE / sizeof(slot_t);
+// most slots a page can have, all holding empty records
 
 // Class definition for a minirel data page.   
-// The design assumes that records are kept compacted when
-// deletions are performed. Notice, however, that the slot
-// array cannot be compacted.  Notice, this class does not keep
+// Deletions leave holes in data[] that are compacted away only
+// when an insert needs contiguous space. Notice, however, that the
+// slot array cannot be compacted.  Notice, this class does not keep
 // the records align, relying instead on upper levels to take
 // care of non-aligned attributes
 
@@ -42,9 +67,22 @@ private:
     short	slotCnt; // number of slots in use;
     short	freePtr; // offset of first free byte in data[]
     short	freeSpace; // number of bytes free in data[]
-    short	dummy;	// for alignment purposes
+    short	freeSlot; // every slot before this one is in use
     int		nextPage; // forwards pointer
     int		curPage;  // page number of current pointer
+    int		dirSlot;  // entry in the file's page directory, -1 if none
+
+    const int contiguousSpace() const;  // free bytes after freePtr
+
+    // slot i is empty or holds a moved record, not one to return
+    const bool hidden(const int i) const
+    {
+        if (slot[i].length >= 0) return false;
+        if (slot[i].length == -1) return true;
+        int type;
+        memcpy(&type, &data[slot[i].offset], sizeof(int));
+        return type == MOVEDREC;
+    }
 
 public:
     void init(const int pageNo); // initialize a new page
@@ -53,13 +91,34 @@ public:
     const Status getNextPage(int& pageNo) const; // returns value of nextPage
     const Status setNextPage(const int pageNo); // sets value of nextPage to pageNo
     const short getFreeSpace() const; // returns amount of free space
+    const int getRecCnt() const;      // returns number of records
+    const int getSlotCnt() const;     // returns number of slots, empty ones included
 
-    // inserts a new record (rec) into the page, returns RID of record 
+    const int getDirSlot() const;     // returns value of dirSlot
+    const Status setDirSlot(const int slotNo); // sets value of dirSlot
+
+    // inserts a new record (rec) into the page, returns RID of record;
+    // rec may be a stub, which getRecord then returns as it was given
     const Status insertRecord(const Record & rec, RID& rid);
 
-    // delete the record with the specified rid
+    // inserts rec after the last slot without looking for an empty
+    // one; for filling a page that has never had a record deleted
+    const Status appendRecord(const Record & rec, RID& rid);
+
+    // replace the record with the specified rid by rec, keeping its
+    // slot: over the old bytes if rec is no longer, otherwise in the
+    // free space, compacting if need be.  NOSPACE if it does not fit
+    const Status updateRecord(const RID & rid, const Record & rec);
+
+    // delete the record with the specified rid; its space is free at
+    // once but only contiguous after the next compact()
     const Status deleteRecord(const RID & rid);
 
+    // move the records together so the free space is contiguous.
+    // Inserts do it when they need to; it moves records, so Record
+    // pointers into the page are stale after it
+    void compact();
+
     // returns RID of first record on page
     // returns  NORECORDS if page contains no records.  Otherwise, returns OK
     const Status firstRecord(RID& firstRid) const;
@@ -70,6 +129,21 @@ public:
 
     // returns reference to record with RID rid
     const Status getRecord(const RID & rid, Record & rec);
+
+    // returns RIDs of and references to up to max records following
+    // curRid, or from the start of the page if curRid is NULLRID, in
+    // one pass over the slot array.  ENDOFPAGE if there are none
+    const Status nextRecords(const RID & curRid, RID rids[], Record recs[],
+                             const int max, int & count);
+
+    // copies the 4 bytes at offset in every record at least offset+4
+    // bytes long to vals[slot number] and sets the slot's bit in valid
+    // (64 to a word); other entries are zeroed.  Unless stubs is NULL
+    // the bits of the slots holding stubs are set in it.  Returns the
+    // number of slots, the length of vals used
+    const int gatherAttr(const int offset, void* vals,
+                         unsigned long long valid[],
+                         unsigned long long stubs[] = NULL) const;
 };
 
 #endif
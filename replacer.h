@@ -0,0 +1,253 @@
+#ifndef REPLACER_H
+#define REPLACER_H
+
+#include <list>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include "db.h"
+
+class BufDesc;
+
+// buffer replacement policies selectable when a BufMgr is built
+enum ReplPolicy { CLOCK, LRUK, TWOQ, ARC };
+
+// identifies a page independent of the frame it occupies; used by
+// policies that remember pages after they have left the pool
+struct PageKey
+{
+  const File* file;
+  int pageNo;
+
+  bool operator == (const PageKey & other) const
+    {
+      return file == other.file && pageNo == other.pageNo;
+    }
+};
+
+struct PageKeyHash
+{
+  size_t operator () (const PageKey & key) const
+    {
+      return hash<const File*>()(key.file) * 31 + key.pageNo;
+    }
+};
+
+// FIFO of pages that have been evicted, bounded to maxSize entries
+class GhostList
+{
+private:
+  unsigned int maxSize;
+  list<PageKey> keys;   // oldest entry at the front
+  unordered_map<PageKey, list<PageKey>::iterator, PageKeyHash> index;
+
+public:
+  GhostList(const unsigned int size) : maxSize(size) {}
+
+  bool contains(const File* file, const int pageNo) const;
+  void push(const File* file, const int pageNo);  // add, dropping the oldest
+  void erase(const File* file, const int pageNo);
+  void popOldest();
+  unsigned int size() const { return keys.size(); }
+};
+
+
+// Interface between BufMgr and a replacement policy.  BufMgr tells the
+// policy about every page it brings in, every hit and every frame it
+// empties; the policy answers which frame to reuse when the pool is
+// full.  Frames that hold no page are kept on a free list here so
+// that policies only have to rank valid frames.
+//
+// The public methods may be called from several threads.  Each one
+// takes latch, except where a policy can record the event with atomic
+// operations alone (e.g. the clock's referenced()).
+
+class Replacer
+{
+protected:
+  int numBufs;
+  BufDesc* bufTable;
+  vector<int> freeFrames;   // frames that currently hold no page
+  vector<bool> onFreeList;  // true if frame is in freeFrames
+  mutex latch;              // protects the policy's state
+
+  // accessors for the BufDesc fields a policy is allowed to look at
+  bool pinned(const int frame) const;
+  bool valid(const int frame) const;
+  atomic<bool> & refbit(const int frame);
+  const File* fileOf(const int frame) const;
+  int pageOf(const int frame) const;
+
+  // called on every miss, before a frame is chosen
+  virtual void missed(const File* file, const int pageNo) {}
+
+  // choose an unpinned valid frame to evict to make room for
+  // (file,pageNo). returns BUFFEREXCEEDED if every frame is pinned
+  virtual const Status victim(const File* file, const int pageNo,
+                              int & frame) = 0;
+
+  // frame no longer holds a page; drop any state kept for it
+  virtual void forget(const int frame) = 0;
+
+  // append up to n valid frames in the order victim() would pick them
+  // if nothing were referenced meanwhile, pinned frames included
+  virtual void nextVictims(const int n, vector<int> & frames) = 0;
+
+public:
+  Replacer(const int bufs, BufDesc* table);
+  virtual ~Replacer() {}
+
+  static Replacer* create(const ReplPolicy policy, const int bufs,
+                          BufDesc* table);
+
+  // return a frame to hold (file,pageNo): a free frame if there is
+  // one (isFree is set and the frame now belongs to the caller),
+  // otherwise a victim chosen by the policy.  A victim is only a
+  // candidate: the caller must still claim it, write it out and then
+  // call evicted().
+  const Status pickFrame(const File* file, const int pageNo, int & frame,
+                         bool & isFree);
+
+  // (file,pageNo) has just been read or allocated into frame
+  virtual void loaded(const int frame, const File* file,
+                      const int pageNo) = 0;
+
+  // page in frame was found in the pool
+  virtual void referenced(const int frame) = 0;
+
+  // page in frame is leaving the pool to make room for another one
+  virtual void evicted(const int frame) = 0;
+
+  // frame has been emptied outside of replacement (flush, dispose,
+  // failed read); put it back on the free list
+  void freed(const int frame);
+
+  // frame is being reused directly by its owner (a scan ring) without
+  // going through pickFrame; drop its state without remembering it
+  void recycled(const int frame);
+
+  // the next n frames the policy expects to evict, soonest first;
+  // used by the background writer to clean them before they are needed
+  void upcoming(const int n, vector<int> & frames);
+};
+
+
+// the original single-refbit clock sweep
+class ClockReplacer : public Replacer
+{
+private:
+  unsigned int clockHand;
+
+  void advanceClock()
+  {
+	clockHand = (clockHand + 1) % numBufs;
+  }
+
+protected:
+  const Status victim(const File* file, const int pageNo, int & frame);
+  void forget(const int frame) {}
+  void nextVictims(const int n, vector<int> & frames);
+
+public:
+  ClockReplacer(const int bufs, BufDesc* table);
+
+  // the reference bit is atomic, so these need no latch
+  void loaded(const int frame, const File* file, const int pageNo);
+  void referenced(const int frame);
+  void evicted(const int frame) {}
+};
+
+
+// LRU-K: evict the page whose K-th most recent reference is oldest.
+// Pages referenced fewer than K times rank before all others, so a
+// page touched once by a scan goes before a page that is re-used.
+class LRUKReplacer : public Replacer
+{
+private:
+  int K;
+  unsigned long now;             // logical clock, bumped per reference
+  vector<unsigned long> hist;    // K reference times per frame, newest first
+
+  void touch(const int frame);
+
+protected:
+  const Status victim(const File* file, const int pageNo, int & frame);
+  void forget(const int frame);
+  void nextVictims(const int n, vector<int> & frames);
+
+public:
+  LRUKReplacer(const int bufs, BufDesc* table, const int k = 2);
+
+  void loaded(const int frame, const File* file, const int pageNo);
+  void referenced(const int frame);
+  void evicted(const int frame);
+};
+
+
+// Full 2Q (Johnson & Shasha): new pages enter the FIFO A1in; pages
+// evicted from A1in are remembered in the ghost queue A1out and go to
+// the LRU queue Am if they are requested again.
+class TwoQReplacer : public Replacer
+{
+private:
+  enum Queue { NONE, A1IN, AM };
+
+  unsigned int kin;              // target size of A1in
+  list<int> a1in;                // FIFO, oldest at front
+  list<int> am;                  // LRU, least recent at front
+  GhostList a1out;
+  vector<Queue> where;           // queue each frame is on
+  vector<list<int>::iterator> pos;
+
+  void unlink(const int frame);
+  bool firstUnpinned(const list<int> & queue, int & frame) const;
+
+protected:
+  const Status victim(const File* file, const int pageNo, int & frame);
+  void forget(const int frame) { unlink(frame); }
+  void nextVictims(const int n, vector<int> & frames);
+
+public:
+  TwoQReplacer(const int bufs, BufDesc* table);
+
+  void loaded(const int frame, const File* file, const int pageNo);
+  void referenced(const int frame);
+  void evicted(const int frame);
+};
+
+
+// ARC (Megiddo & Modha): T1 holds pages seen once, T2 pages seen at
+// least twice, B1/B2 remember pages recently evicted from each.  Hits
+// in B1/B2 move the target size p of T1 up or down.
+class ARCReplacer : public Replacer
+{
+private:
+  enum Queue { NONE, T1, T2 };
+
+  int p;                         // target size of T1
+  list<int> t1;                  // LRU, least recent at front
+  list<int> t2;
+  GhostList b1;
+  GhostList b2;
+  vector<Queue> where;
+  vector<list<int>::iterator> pos;
+
+  void unlink(const int frame);
+  bool firstUnpinned(const list<int> & queue, int & frame) const;
+
+protected:
+  void missed(const File* file, const int pageNo);
+  const Status victim(const File* file, const int pageNo, int & frame);
+  void forget(const int frame) { unlink(frame); }
+  void nextVictims(const int n, vector<int> & frames);
+
+public:
+  ARCReplacer(const int bufs, BufDesc* table);
+
+  void loaded(const int frame, const File* file, const int pageNo);
+  void referenced(const int frame);
+  void evicted(const int frame);
+};
+
+#endif
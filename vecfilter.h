@@ -0,0 +1,18 @@
+#ifndef VECFILTER_H
+#define VECFILTER_H
+
+#include "heapfile.h"
+
+// Compare vals[0..n-1] with key and set bit i of bits (64 to a word)
+// for every vals[i] op key, clearing the others.  Works 8 values at a
+// time with AVX2 or 4 with SSE2 where the CPU has them, chosen on the
+// first call; otherwise one at a time.
+void filterInts(const Operator op, const int vals[], const int n,
+                const int key, unsigned long long bits[]);
+void filterFloats(const Operator op, const float vals[], const int n,
+                  const float key, unsigned long long bits[]);
+
+// the implementation in use: "avx2", "sse2" or "scalar"
+const char* filterImpl();
+
+#endif